@@ -1,361 +1,663 @@
-#include <assert.h>
-#include <stddef.h>
-#include <stdlib.h>
-#include <errno.h>
-#include <math.h>
-#include <string.h>
-#include "cjson.h"
-
-#ifndef JSON_PARSE_STACK_INIT_SIZE
-#define JSON_PARSE_STACK_INIT_SIZE 256
-#endif
-
-#define EXPECT(c, ch) do{ assert(*c->json == (ch)); c->json++;} while(0)
-#define ISWHITE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
-#define ISDIGIT(ch) ('0' <= (ch) && (ch) <= '9')
-#define ISHEXDIGIT(ch) (('0' <= (ch) && (ch) <= '9') || ('A' <= (ch) && (ch) <= 'F') || ('a' <= (ch) && (ch) <= 'f'))
-#define ISDIGIT1TO9(ch) ('1' <= (ch) && (ch) <= '9')
-#define EATDIGIT(n) do{ while(ISDIGIT(*n)) n++; }while(0)
-#define PUTC(c, ch) do { *(char *)json_context_push(c, sizeof(char)) = ch; } while(0)
-#define RET_ERROR_AND_SET_STACK(c, ret, head) do { (c)->top = (head); return ret; } while(0)
-
-static void json_parse_whitespace(json_context *c);
-
-static int json_parse_value(json_context *c, json_value *v);
-
-static int json_parse_number(json_context *c, json_value *v);
-
-static int json_parse_string(json_context *c, json_value *ptr);
-
-static int json_parse_literal(json_context *c, json_value *v, const char *literal, json_type type);
-
-static void *json_context_pop(json_context *c, size_t size);
-
-static void *json_context_push(json_context *c, size_t size);
-
-static const char *json_parse_hex4(const char *p, unsigned int *u);
-
-static void json_encode_utf8(json_context *c, unsigned int u);
-
-static int json_parse_array(json_context *c, json_value *v);
-
-int json_parse(json_value *v, const char *json) {
-        json_context c;
-        int parse_result;
-        assert(v != NULL);
-        c.json = json;
-        c.stack = NULL;
-        c.size = c.top = 0;
-        json_val_init(v);
-        parse_result = json_parse_value(&c, v);
-        if (parse_result == JSON_PARSE_OK){
-                json_parse_whitespace(&c);
-                if(*c.json != '\0')
-                        parse_result = JSON_PARSE_ROOT_NOT_SINGULAR;
-        }
-        assert(c.top == 0);
-        free(c.stack);
-        return parse_result;
-}
-
-static int json_parse_value(json_context *c, json_value *v) {
-        json_parse_whitespace(c);
-        switch (*c->json) {
-        case 'n':return json_parse_literal(c, v, "null", JSON_NULL);
-        case 't':return json_parse_literal(c, v, "true", JSON_TRUE);
-        case 'f':return json_parse_literal(c, v, "false", JSON_FALSE);
-        case '\"':return json_parse_string(c, v);
-        case '[':return json_parse_array(c, v);
-        case '\0':return JSON_PARSE_EXPECT_VALUE;
-        default:return json_parse_number(c, v);
-        }
-}
-
-static void json_parse_whitespace(json_context *c) {
-        const char *p = c->json;
-        while (ISWHITE(*p))
-                p++;
-        c->json = p;
-}
-
-int json_parse_number(json_context *c, json_value *v) {
-        // 负数
-        char *ptr = c->json;
-        if (*ptr == '-')ptr++;
-        // 整数
-        if (*ptr == '0'){
-                ptr++;
-                if(!(*ptr == '.' || ISWHITE(*ptr) || *ptr == '\0'))
-                        return JSON_PARSE_ROOT_NOT_SINGULAR;
-        } else {
-                if (ISDIGIT1TO9(*ptr)) EATDIGIT(ptr);
-                else return JSON_PARSE_INVALID_VALUE;
-        }
-        // 小数
-        if (*ptr == '.') {
-                ptr++;
-                if (!ISDIGIT(*ptr)) return JSON_PARSE_INVALID_VALUE;
-                EATDIGIT(ptr);
-        }
-
-        // 指数
-        if (*ptr == 'e' || *ptr == 'E') {
-                ptr++;
-                if (*ptr == '+' || *ptr == '-') ptr++;
-                if (!ISDIGIT(*ptr)) return JSON_PARSE_INVALID_VALUE;
-                EATDIGIT(ptr);
-        }
-        v->val.number = strtod(c->json, NULL);
-        if (errno == ERANGE && (v->val.number == HUGE_VAL || v->val.number == -HUGE_VAL))
-                return JSON_PARSE_NUMBER_TOO_BIG;
-        c->json = ptr;
-        v->type = JSON_NUMBER;
-        return JSON_PARSE_OK;
-}
-
-static int json_parse_literal(json_context *c, json_value *v, const char *literal, json_type type) {
-        size_t i;
-        for (i = 0; literal[i]; i++)
-                if (c->json[i] != literal[i])
-                        return JSON_PARSE_INVALID_VALUE;
-        c->json += i;
-        v->type = type;
-        return JSON_PARSE_OK;
-}
-
-static int json_parse_string(json_context *c, json_value *v) {
-        size_t head = c->top, len;
-        const char *p;
-        EXPECT(c, '\"');
-        p = c->json;
-        unsigned u;
-        while (1) {
-                char ch = *p++;
-                switch (ch) {
-                case '\\':
-                        switch (*p++) {
-                        case '\\':PUTC(c, '\\');break;
-                        case '\"':PUTC(c, '\"');break;
-                        case 'b':PUTC(c, '\b');break;
-                        case 'f':PUTC(c, '\f');break;
-                        case 'n':PUTC(c, '\n');break;
-                        case 'r':PUTC(c, '\r');break;
-                        case 't':PUTC(c, '\t');break;
-                        case '/':PUTC(c, '/');break;
-                        case 'u':
-                                if (!(p = json_parse_hex4(p, &u)))
-                                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_HEX, head);
-                                if(0xD800 <= u && u <= 0xDBFF){
-                                        unsigned h = u;
-                                        if(*p++ != '\\')
-                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
-                                        if(*p++ != 'u')
-                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
-                                        if(!(p = json_parse_hex4(p, &u)))
-                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_HEX, head);
-                                        if(!(0xDC00 <= u && u <= 0xDFFF))
-                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
-                                        u = 0x10000 + (((h - 0xD800) << 10) | (u - 0xDC00));
-                                }
-                                json_encode_utf8(c, u);
-                                break;
-                        default:
-                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_STRING_ESCAPE, head);
-                        }
-                        break;
-                case '\"':
-                        len = c->top - head;
-                        json_set_string(v, (const char *) json_context_pop(c, len), len);
-                        c->json = p;
-                        return JSON_PARSE_OK;
-                case '\0':
-                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_MISS_QUOTATION_MARK, head);
-                default:
-                        if ((unsigned char) ch < 0x20)
-                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_STRING_CHAR, head);
-                        PUTC(c, ch);
-                }
-        }
-}
-
-
-static int json_parse_array(json_context *c, json_value *v) {
-        EXPECT(c, '[');
-        size_t head = c->top, size = 0;
-        int ret;
-        json_parse_whitespace(c);
-        if (*c->json == ']') {
-                c->json++;
-                v->type = JSON_ARRAY;
-                v->val.arr.size = 0;
-                v->val.arr.e = NULL;
-                return JSON_PARSE_OK;
-        }
-        json_value e;
-        json_val_init(&e);
-        while (1) {
-                if ((ret = json_parse_value(c, &e)) != JSON_PARSE_OK) {
-                        size_t i;
-                        for (i = 0; i < size; i++) json_val_free(json_context_pop(c, sizeof(json_value)));
-                        RET_ERROR_AND_SET_STACK(c, ret, head);
-                }
-                memcpy(json_context_push(c, sizeof(json_value)), &e, sizeof(json_value));
-                size++;
-                json_parse_whitespace(c);
-                if(*c->json == ','){
-                        c->json++;
-                        json_parse_whitespace(c);
-                        if(*c->json == ']'){
-                                json_val_free(v);
-                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_VALUE, head);
-                        }
-                } else if (*c->json == ']') {
-                        c->json++;
-                        v->type = JSON_ARRAY;
-                        v->val.arr.size = size;
-                        size *= sizeof(json_value);
-                        memcpy(v->val.arr.e = (json_value *) malloc(size), json_context_pop(c, size), size);
-                        return JSON_PARSE_OK;
-                } else
-                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, head);
-        }
-}
-
-json_type json_get_type(const json_value *v) {
-        assert(v != NULL);
-        return v->type;
-}
-
-double json_get_number(const json_value *v) {
-        assert(v != NULL);
-        assert(v->type == JSON_NUMBER);
-        return v->val.number;
-}
-
-void json_set_boolean(json_value *v, int b) {
-        assert(v != NULL);
-        json_val_free(v);
-        if (!b)
-                v->type = JSON_FALSE;
-        else
-                v->type = JSON_TRUE;
-}
-
-int json_get_boolean(const json_value *v) {
-        assert(v != NULL && (v->type == JSON_TRUE || v->type == JSON_FALSE));
-        if (v->type == JSON_TRUE)
-                return 1;
-        if (v->type == JSON_FALSE)
-                return 0;
-}
-
-void json_set_number(json_value *v, double n) {
-        assert(v != NULL);
-        json_val_free(v);
-        v->type = JSON_NUMBER;
-        v->val.number = n;
-}
-
-void json_set_string(json_value *v, const char *s, size_t len) {
-        assert(v != NULL && (s != NULL || len == 0));
-        json_val_free(v);
-        v->val.str.s = (char *) malloc(len + 1);
-        memcpy(v->val.str.s, s, len);
-        v->val.str.s[len] = '\0';
-        v->val.str.len = len;
-        v->type = JSON_STRING;
-}
-
-size_t json_get_string_length(json_value *v) {
-        assert(v != NULL && v->type == JSON_STRING);
-        return v->val.str.len;
-}
-
-const char *json_get_string(json_value *v) {
-        assert(v != NULL && v->type == JSON_STRING);
-        return v->val.str.s;
-}
-
-void json_val_free(json_value *v) {
-        assert(v != NULL);
-        if (v->type == JSON_STRING)
-                free(v->val.str.s);
-        else if (v->type == JSON_ARRAY){
-                size_t i, size;
-                for (i = 0, size = v->val.arr.size; i < size; i++) {
-                        json_val_free(json_get_array_element(v, i));
-                }
-                free(v->val.arr.e);
-        }
-        v->type = JSON_NULL;
-}
-
-size_t json_get_array_size(json_value *v) {
-        assert(v != NULL && v->type == JSON_ARRAY);
-        return v->val.arr.size;
-}
-
-json_value *json_get_array_element(json_value *v, size_t index) {
-        assert(v != NULL && v->type == JSON_ARRAY);
-        assert(index < v->val.arr.size);
-        return &v->val.arr.e[index];
-}
-
-static void *json_context_pop(json_context *c, size_t size) {
-        assert(c->top >= size);
-        return c->stack + (c->top -= size);
-}
-
-void *json_context_push(json_context *c, size_t size) {
-        void *ret;
-        assert(size > 0);
-        if (c->top + size >= c->size) {
-                if (c->size == 0)
-                        c->size = JSON_PARSE_STACK_INIT_SIZE;
-                while (c->top + size >= c->size)
-                        c->size += c->size >> 1; // c->size = c->size*1.5
-                c->stack = (char *) realloc(c->stack, c->size);
-        }
-        ret = c->stack + c->top;
-        c->top += size;
-        return ret;
-}
-
-unsigned int hex_to_int(const char c) {
-        assert(ISHEXDIGIT(c));
-        if (ISDIGIT(c)) return c - '0';
-        else if('A' <= c && c <= 'F') return c - 'A' + 10;
-        else if('a' <= c && c <= 'f') return c - 'a' + 10;
-}
-
-const char *json_parse_hex4(const char *p, unsigned int *u) {
-        assert(p != NULL && u != NULL);
-        if (ISHEXDIGIT(p[0]) && ISHEXDIGIT(p[1])
-            && ISHEXDIGIT(p[2]) && ISHEXDIGIT(p[3])) {
-                *u = (hex_to_int(p[0]) << 12) +
-                     (hex_to_int(p[1]) << 8)  +
-                     (hex_to_int(p[2]) << 4)  +
-                     (hex_to_int(p[3]) << 0)  ;
-                return p + 4;
-        }
-        return NULL;
-}
-
-void json_encode_utf8(json_context *c, unsigned int u) {
-        if(u <= 0x007F){
-                PUTC(c, 0xFF & u);
-        } else if(u <= 0x07FF){
-                PUTC(c, 0xC0 | (0xFF & u>>6));
-                PUTC(c, 0x80 | (0x7F & u>>0));
-        } else if(u <= 0xFFFF){
-                PUTC(c, 0xE0 | (0xFF & u>>12));
-                PUTC(c, 0x80 | (0x3F & u>>6));
-                PUTC(c, 0x80 | (0x3F & u>>0));
-        } else{
-                assert(u <= 0x10FFFF);
-                PUTC(c, 0xF0 | (0xFF & u>>18));
-                PUTC(c, 0x80 | (0x3F & u>>12));
-                PUTC(c, 0x80 | (0x3F & u>>6));
-                PUTC(c, 0x80 | (0x3F & u>>0));
-        }
-}
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "cjson.h"
+
+#ifndef JSON_PARSE_STACK_INIT_SIZE
+#define JSON_PARSE_STACK_INIT_SIZE 256
+#endif
+
+#define EXPECT(c, ch) do{ assert(*c->json == (ch)); c->json++;} while(0)
+#define ISWHITE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+#define ISDIGIT(ch) ('0' <= (ch) && (ch) <= '9')
+#define ISHEXDIGIT(ch) (('0' <= (ch) && (ch) <= '9') || ('A' <= (ch) && (ch) <= 'F') || ('a' <= (ch) && (ch) <= 'f'))
+#define ISDIGIT1TO9(ch) ('1' <= (ch) && (ch) <= '9')
+#define EATDIGIT(n) do{ while(ISDIGIT(*n)) n++; }while(0)
+#define PUTC(c, ch) do { *(char *)json_context_push(c, sizeof(char)) = ch; } while(0)
+#define RET_ERROR_AND_SET_STACK(c, ret, head) do { (c)->top = (head); return ret; } while(0)
+#define JSON_BINARY_MAGIC "CJB1"
+#define JSON_BINARY_MAX_SIZE 0xFFFFFFFFUL
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(p, x) __atomic_store_n((p), (x), __ATOMIC_SEQ_CST)
+#define ATOMIC_EXCHANGE(p, x) __atomic_exchange_n((p), (x), __ATOMIC_SEQ_CST)
+#define ATOMIC_ADD(p, x) __atomic_add_fetch((p), (x), __ATOMIC_SEQ_CST)
+#define ATOMIC_SUB(p, x) __atomic_sub_fetch((p), (x), __ATOMIC_SEQ_CST)
+#else
+#error "json_document needs the __atomic builtins of GCC or Clang"
+#endif
+
+struct json_document {
+    json_value root;
+    size_t refcount;
+};
+
+static int json_parse_string(json_context *c, json_value *ptr);
+
+static int json_parse_literal(json_context *c, json_value *v, const char *literal, json_type type);
+
+static void *json_context_pop(json_context *c, size_t size);
+
+static void *json_context_push(json_context *c, size_t size);
+
+static const char *json_parse_hex4(const char *p, unsigned int *u);
+
+static void json_encode_utf8(json_context *c, unsigned int u);
+
+static int json_parse_array(json_context *c, json_value *v);
+
+static void json_encode_binary_value(json_context *c, const json_value *v);
+
+static int json_decode_binary_value(const unsigned char *b, size_t length, size_t node, size_t *end, json_value *v);
+
+static void json_binary_write_u32(char *p, size_t u);
+
+static size_t json_binary_read_u32(const char *p);
+
+int json_parse(json_value *v, const char *json) {
+        json_context c;
+        int parse_result;
+        assert(v != NULL);
+        c.json = json;
+        c.stack = NULL;
+        c.size = c.top = 0;
+        json_val_init(v);
+        parse_result = json_parse_value(&c, v);
+        if (parse_result == JSON_PARSE_OK){
+                json_parse_whitespace(&c);
+                if(*c.json != '\0'){
+                        json_val_free(v);
+                        parse_result = JSON_PARSE_ROOT_NOT_SINGULAR;
+                }
+        }
+        assert(c.top == 0);
+        free(c.stack);
+        return parse_result;
+}
+
+int json_parse_value(json_context *c, json_value *v) {
+        json_parse_whitespace(c);
+        switch (*c->json) {
+        case 'n':return json_parse_literal(c, v, "null", JSON_NULL);
+        case 't':return json_parse_literal(c, v, "true", JSON_TRUE);
+        case 'f':return json_parse_literal(c, v, "false", JSON_FALSE);
+        case '\"':return json_parse_string(c, v);
+        case '[':return json_parse_array(c, v);
+        case '\0':return JSON_PARSE_EXPECT_VALUE;
+        default:return json_parse_number(c, v);
+        }
+}
+
+void json_parse_whitespace(json_context *c) {
+        const char *p = c->json;
+        while (ISWHITE(*p))
+                p++;
+        c->json = p;
+}
+
+int json_parse_number(json_context *c, json_value *v) {
+        // 负数
+        char *ptr = c->json;
+        if (*ptr == '-')ptr++;
+        // 整数
+        if (*ptr == '0'){
+                ptr++;
+                if(ISDIGIT(*ptr))
+                        return JSON_PARSE_ROOT_NOT_SINGULAR;
+        } else {
+                if (ISDIGIT1TO9(*ptr)) EATDIGIT(ptr);
+                else return JSON_PARSE_INVALID_VALUE;
+        }
+        // 小数
+        if (*ptr == '.') {
+                ptr++;
+                if (!ISDIGIT(*ptr)) return JSON_PARSE_INVALID_VALUE;
+                EATDIGIT(ptr);
+        }
+
+        // 指数
+        if (*ptr == 'e' || *ptr == 'E') {
+                ptr++;
+                if (*ptr == '+' || *ptr == '-') ptr++;
+                if (!ISDIGIT(*ptr)) return JSON_PARSE_INVALID_VALUE;
+                EATDIGIT(ptr);
+        }
+        v->val.number = strtod(c->json, NULL);
+        if (errno == ERANGE && (v->val.number == HUGE_VAL || v->val.number == -HUGE_VAL))
+                return JSON_PARSE_NUMBER_TOO_BIG;
+        c->json = ptr;
+        v->type = JSON_NUMBER;
+        return JSON_PARSE_OK;
+}
+
+static int json_parse_literal(json_context *c, json_value *v, const char *literal, json_type type) {
+        size_t i;
+        for (i = 0; literal[i]; i++)
+                if (c->json[i] != literal[i])
+                        return JSON_PARSE_INVALID_VALUE;
+        c->json += i;
+        v->type = type;
+        return JSON_PARSE_OK;
+}
+
+int json_parse_string_raw(json_context *c, const char **str, size_t *len) {
+        size_t head = c->top;
+        const char *p;
+        EXPECT(c, '\"');
+        p = c->json;
+        unsigned u;
+        while (1) {
+                char ch = *p++;
+                switch (ch) {
+                case '\\':
+                        switch (*p++) {
+                        case '\\':PUTC(c, '\\');break;
+                        case '\"':PUTC(c, '\"');break;
+                        case 'b':PUTC(c, '\b');break;
+                        case 'f':PUTC(c, '\f');break;
+                        case 'n':PUTC(c, '\n');break;
+                        case 'r':PUTC(c, '\r');break;
+                        case 't':PUTC(c, '\t');break;
+                        case '/':PUTC(c, '/');break;
+                        case 'u':
+                                if (!(p = json_parse_hex4(p, &u)))
+                                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_HEX, head);
+                                if(0xD800 <= u && u <= 0xDBFF){
+                                        unsigned h = u;
+                                        if(*p++ != '\\')
+                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
+                                        if(*p++ != 'u')
+                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
+                                        if(!(p = json_parse_hex4(p, &u)))
+                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_HEX, head);
+                                        if(!(0xDC00 <= u && u <= 0xDFFF))
+                                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_UNICODE_SURROGATE, head);
+                                        u = 0x10000 + (((h - 0xD800) << 10) | (u - 0xDC00));
+                                }
+                                json_encode_utf8(c, u);
+                                break;
+                        default:
+                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_STRING_ESCAPE, head);
+                        }
+                        break;
+                case '\"':
+                        *len = c->top - head;
+                        *str = (const char *) json_context_pop(c, *len);
+                        c->json = p;
+                        return JSON_PARSE_OK;
+                case '\0':
+                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_MISS_QUOTATION_MARK, head);
+                default:
+                        if ((unsigned char) ch < 0x20)
+                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_STRING_CHAR, head);
+                        PUTC(c, ch);
+                }
+        }
+}
+
+
+static int json_parse_string(json_context *c, json_value *v) {
+        const char *s;
+        size_t len;
+        int ret;
+        if ((ret = json_parse_string_raw(c, &s, &len)) == JSON_PARSE_OK)
+                json_set_string(v, s, len);
+        return ret;
+}
+
+static int json_parse_array(json_context *c, json_value *v) {
+        EXPECT(c, '[');
+        size_t head = c->top, size = 0;
+        int ret;
+        json_parse_whitespace(c);
+        if (*c->json == ']') {
+                c->json++;
+                v->type = JSON_ARRAY;
+                v->val.arr.size = 0;
+                v->val.arr.e = NULL;
+                return JSON_PARSE_OK;
+        }
+        json_value e;
+        json_val_init(&e);
+        while (1) {
+                if ((ret = json_parse_value(c, &e)) != JSON_PARSE_OK) {
+                        size_t i;
+                        for (i = 0; i < size; i++) json_val_free(json_context_pop(c, sizeof(json_value)));
+                        RET_ERROR_AND_SET_STACK(c, ret, head);
+                }
+                memcpy(json_context_push(c, sizeof(json_value)), &e, sizeof(json_value));
+                size++;
+                json_parse_whitespace(c);
+                if(*c->json == ','){
+                        c->json++;
+                        json_parse_whitespace(c);
+                        if(*c->json == ']'){
+                                json_val_free(v);
+                                RET_ERROR_AND_SET_STACK(c, JSON_PARSE_INVALID_VALUE, head);
+                        }
+                } else if (*c->json == ']') {
+                        c->json++;
+                        v->type = JSON_ARRAY;
+                        v->val.arr.size = size;
+                        size *= sizeof(json_value);
+                        memcpy(v->val.arr.e = (json_value *) malloc(size), json_context_pop(c, size), size);
+                        return JSON_PARSE_OK;
+                } else
+                        RET_ERROR_AND_SET_STACK(c, JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, head);
+        }
+}
+
+json_type json_get_type(const json_value *v) {
+        assert(v != NULL);
+        return v->type;
+}
+
+double json_get_number(const json_value *v) {
+        assert(v != NULL);
+        assert(v->type == JSON_NUMBER);
+        return v->val.number;
+}
+
+void json_set_boolean(json_value *v, int b) {
+        assert(v != NULL);
+        json_val_free(v);
+        if (!b)
+                v->type = JSON_FALSE;
+        else
+                v->type = JSON_TRUE;
+}
+
+int json_get_boolean(const json_value *v) {
+        assert(v != NULL && (v->type == JSON_TRUE || v->type == JSON_FALSE));
+        if (v->type == JSON_TRUE)
+                return 1;
+        if (v->type == JSON_FALSE)
+                return 0;
+}
+
+void json_set_number(json_value *v, double n) {
+        assert(v != NULL);
+        json_val_free(v);
+        v->type = JSON_NUMBER;
+        v->val.number = n;
+}
+
+void json_set_string(json_value *v, const char *s, size_t len) {
+        assert(v != NULL && (s != NULL || len == 0));
+        json_val_free(v);
+        v->val.str.s = (char *) malloc(len + 1);
+        memcpy(v->val.str.s, s, len);
+        v->val.str.s[len] = '\0';
+        v->val.str.len = len;
+        v->type = JSON_STRING;
+}
+
+size_t json_get_string_length(const json_value *v) {
+        assert(v != NULL && v->type == JSON_STRING);
+        return v->val.str.len;
+}
+
+const char *json_get_string(const json_value *v) {
+        assert(v != NULL && v->type == JSON_STRING);
+        return v->val.str.s;
+}
+
+void json_val_free(json_value *v) {
+        assert(v != NULL);
+        if (v->type == JSON_STRING)
+                free(v->val.str.s);
+        else if (v->type == JSON_ARRAY){
+                size_t i, size;
+                for (i = 0, size = v->val.arr.size; i < size; i++) {
+                        json_val_free(&v->val.arr.e[i]);
+                }
+                free(v->val.arr.e);
+        }
+        v->type = JSON_NULL;
+}
+
+size_t json_get_array_size(const json_value *v) {
+        assert(v != NULL && v->type == JSON_ARRAY);
+        return v->val.arr.size;
+}
+
+const json_value *json_get_array_element(const json_value *v, size_t index) {
+        assert(v != NULL && v->type == JSON_ARRAY);
+        assert(index < v->val.arr.size);
+        return &v->val.arr.e[index];
+}
+
+int json_document_parse(json_document **d, const char *json) {
+        json_value v;
+        int ret;
+        assert(d != NULL);
+        *d = NULL;
+        if ((ret = json_parse(&v, json)) == JSON_PARSE_OK)
+                *d = json_document_create(&v);
+        return ret;
+}
+
+json_document *json_document_create(json_value *v) {
+        json_document *d;
+        assert(v != NULL);
+        d = (json_document *) malloc(sizeof(json_document));
+        memcpy(&d->root, v, sizeof(json_value));
+        d->refcount = 1;
+        json_val_init(v);
+        return d;
+}
+
+json_document *json_document_retain(json_document *d) {
+        assert(d != NULL);
+        ATOMIC_ADD(&d->refcount, 1);
+        return d;
+}
+
+void json_document_release(json_document *d) {
+        if (d != NULL && ATOMIC_SUB(&d->refcount, 1) == 0) {
+                json_val_free(&d->root);
+                free(d);
+        }
+}
+
+const json_value *json_document_root(const json_document *d) {
+        assert(d != NULL);
+        return &d->root;
+}
+
+void json_slot_init(json_slot *s, json_document *d) {
+        assert(s != NULL);
+        s->current = d;
+        s->epoch = 0;
+        s->readers[0] = s->readers[1] = 0;
+        s->publishing = 0;
+}
+
+/*
+ * A reader announces itself in the counter of the epoch it observed, then
+ * re-checks the epoch: if a publisher flipped it in between, the publisher
+ * may not wait for that counter, so the reader backs out and retries.
+ */
+json_document *json_slot_acquire(json_slot *s) {
+        json_document *d;
+        size_t e;
+        assert(s != NULL);
+        while (1) {
+                e = ATOMIC_LOAD(&s->epoch);
+                ATOMIC_ADD(&s->readers[e & 1], 1);
+                if (ATOMIC_LOAD(&s->epoch) == e)
+                        break;
+                ATOMIC_SUB(&s->readers[e & 1], 1);
+        }
+        if ((d = ATOMIC_LOAD(&s->current)) != NULL)
+                json_document_retain(d);
+        ATOMIC_SUB(&s->readers[e & 1], 1);
+        return d;
+}
+
+void json_slot_publish(json_slot *s, json_document *d) {
+        json_document *old;
+        size_t e;
+        assert(s != NULL);
+        while (ATOMIC_EXCHANGE(&s->publishing, 1))
+                ; // one publisher at a time
+        old = ATOMIC_EXCHANGE(&s->current, d);
+        e = ATOMIC_LOAD(&s->epoch);
+        ATOMIC_STORE(&s->epoch, e + 1);
+        while (ATOMIC_LOAD(&s->readers[e & 1]) != 0)
+                ; // grace period: readers that may still be retaining old
+        ATOMIC_STORE(&s->publishing, 0);
+        json_document_release(old);
+}
+
+void json_slot_free(json_slot *s) {
+        assert(s != NULL);
+        json_document_release(s->current);
+        s->current = NULL;
+}
+
+static void *json_context_pop(json_context *c, size_t size) {
+        assert(c->top >= size);
+        return c->stack + (c->top -= size);
+}
+
+void *json_context_push(json_context *c, size_t size) {
+        void *ret;
+        assert(size > 0);
+        if (c->top + size >= c->size) {
+                if (c->size == 0)
+                        c->size = JSON_PARSE_STACK_INIT_SIZE;
+                while (c->top + size >= c->size)
+                        c->size += c->size >> 1; // c->size = c->size*1.5
+                c->stack = (char *) realloc(c->stack, c->size);
+        }
+        ret = c->stack + c->top;
+        c->top += size;
+        return ret;
+}
+
+unsigned int hex_to_int(const char c) {
+        assert(ISHEXDIGIT(c));
+        if (ISDIGIT(c)) return c - '0';
+        else if('A' <= c && c <= 'F') return c - 'A' + 10;
+        else if('a' <= c && c <= 'f') return c - 'a' + 10;
+}
+
+const char *json_parse_hex4(const char *p, unsigned int *u) {
+        assert(p != NULL && u != NULL);
+        if (ISHEXDIGIT(p[0]) && ISHEXDIGIT(p[1])
+            && ISHEXDIGIT(p[2]) && ISHEXDIGIT(p[3])) {
+                *u = (hex_to_int(p[0]) << 12) +
+                     (hex_to_int(p[1]) << 8)  +
+                     (hex_to_int(p[2]) << 4)  +
+                     (hex_to_int(p[3]) << 0)  ;
+                return p + 4;
+        }
+        return NULL;
+}
+
+void json_encode_utf8(json_context *c, unsigned int u) {
+        if(u <= 0x007F){
+                PUTC(c, 0xFF & u);
+        } else if(u <= 0x07FF){
+                PUTC(c, 0xC0 | (0xFF & u>>6));
+                PUTC(c, 0x80 | (0x7F & u>>0));
+        } else if(u <= 0xFFFF){
+                PUTC(c, 0xE0 | (0xFF & u>>12));
+                PUTC(c, 0x80 | (0x3F & u>>6));
+                PUTC(c, 0x80 | (0x3F & u>>0));
+        } else{
+                assert(u <= 0x10FFFF);
+                PUTC(c, 0xF0 | (0xFF & u>>18));
+                PUTC(c, 0x80 | (0x3F & u>>12));
+                PUTC(c, 0x80 | (0x3F & u>>6));
+                PUTC(c, 0x80 | (0x3F & u>>0));
+        }
+}
+
+char *json_encode_binary(const json_value *v, size_t *length) {
+        json_context c;
+        assert(v != NULL && length != NULL);
+        c.stack = NULL;
+        c.size = c.top = 0;
+        memcpy(json_context_push(&c, JSON_BINARY_ROOT), JSON_BINARY_MAGIC, JSON_BINARY_ROOT);
+        json_encode_binary_value(&c, v);
+        // every offset and length is bounded by the image size
+        if (c.top > JSON_BINARY_MAX_SIZE) {
+                free(c.stack);
+                return NULL;
+        }
+        *length = c.top;
+        return (char *) realloc(c.stack, c.top);
+}
+
+static void json_encode_binary_value(json_context *c, const json_value *v) {
+        size_t i, size, table;
+        PUTC(c, (char) v->type);
+        switch (v->type) {
+        case JSON_NUMBER:
+                memcpy(json_context_push(c, sizeof(double)), &v->val.number, sizeof(double));
+                break;
+        case JSON_STRING:
+                json_binary_write_u32(json_context_push(c, 4), v->val.str.len);
+                memcpy(json_context_push(c, v->val.str.len + 1), v->val.str.s, v->val.str.len + 1);
+                break;
+        case JSON_ARRAY:
+                size = v->val.arr.size;
+                json_binary_write_u32(json_context_push(c, 4), size);
+                if (size == 0)
+                        break;
+                table = c->top;
+                json_context_push(c, 4 * size);
+                for (i = 0; i < size; i++) {
+                        // the stack may move while encoding, so patch by position
+                        json_binary_write_u32(c->stack + table + 4 * i, c->top);
+                        json_encode_binary_value(c, &v->val.arr.e[i]);
+                }
+                break;
+        default:
+                break;
+        }
+}
+
+int json_decode_binary(json_value *v, const char *bin, size_t length) {
+        size_t end;
+        int ret;
+        assert(v != NULL && (bin != NULL || length == 0));
+        json_val_init(v);
+        if (length < JSON_BINARY_ROOT || memcmp(bin, JSON_BINARY_MAGIC, JSON_BINARY_ROOT) != 0)
+                return JSON_PARSE_INVALID_BINARY;
+        ret = json_decode_binary_value((const unsigned char *) bin, length, JSON_BINARY_ROOT, &end, v);
+        if (ret == JSON_PARSE_OK && end != length)
+                ret = JSON_PARSE_ROOT_NOT_SINGULAR;
+        if (ret != JSON_PARSE_OK)
+                json_val_free(v);
+        return ret;
+}
+
+int json_binary_check(const char *bin, size_t length) {
+        size_t end;
+        int ret;
+        assert(bin != NULL || length == 0);
+        if (length < JSON_BINARY_ROOT || memcmp(bin, JSON_BINARY_MAGIC, JSON_BINARY_ROOT) != 0)
+                return JSON_PARSE_INVALID_BINARY;
+        ret = json_decode_binary_value((const unsigned char *) bin, length, JSON_BINARY_ROOT, &end, NULL);
+        if (ret == JSON_PARSE_OK && end != length)
+                ret = JSON_PARSE_ROOT_NOT_SINGULAR;
+        return ret;
+}
+
+/*
+ * Validates the node at `node` and, when v is not NULL, decodes it into v.
+ * Elements must be laid out back to back exactly as the encoder writes them,
+ * which keeps validation linear and rules out cyclic or shared offsets.
+ */
+static int json_decode_binary_value(const unsigned char *b, size_t length, size_t node, size_t *end, json_value *v) {
+        size_t i, size, len, next;
+        const char *p = (const char *) b + node + 1;
+        int ret;
+        if (node >= length)
+                return JSON_PARSE_INVALID_BINARY;
+        len = length - node - 1;
+        switch (b[node]) {
+        case JSON_NULL:
+        case JSON_FALSE:
+        case JSON_TRUE:
+                if (v) v->type = (json_type) b[node];
+                *end = node + 1;
+                return JSON_PARSE_OK;
+        case JSON_NUMBER:
+                if (len < sizeof(double))
+                        return JSON_PARSE_INVALID_BINARY;
+                if (v) {
+                        memcpy(&v->val.number, p, sizeof(double));
+                        v->type = JSON_NUMBER;
+                }
+                *end = node + 1 + sizeof(double);
+                return JSON_PARSE_OK;
+        case JSON_STRING:
+                if (len < 4)
+                        return JSON_PARSE_INVALID_BINARY;
+                size = json_binary_read_u32(p);
+                if (len - 4 <= size || p[4 + size] != '\0')
+                        return JSON_PARSE_INVALID_BINARY;
+                if (v) json_set_string(v, p + 4, size);
+                *end = node + 5 + size + 1;
+                return JSON_PARSE_OK;
+        case JSON_ARRAY:
+                if (len < 4)
+                        return JSON_PARSE_INVALID_BINARY;
+                size = json_binary_read_u32(p);
+                if ((len - 4) / 4 < size)
+                        return JSON_PARSE_INVALID_BINARY;
+                if (v) {
+                        v->type = JSON_ARRAY;
+                        v->val.arr.size = size;
+                        v->val.arr.e = size ? (json_value *) malloc(size * sizeof(json_value)) : NULL;
+                        for (i = 0; i < size; i++) json_val_init(&v->val.arr.e[i]);
+                }
+                next = node + 5 + 4 * size;
+                for (i = 0; i < size; i++) {
+                        if (json_binary_read_u32(p + 4 + 4 * i) != next)
+                                return JSON_PARSE_INVALID_BINARY;
+                        ret = json_decode_binary_value(b, length, next, &next, v ? &v->val.arr.e[i] : NULL);
+                        if (ret != JSON_PARSE_OK)
+                                return ret;
+                }
+                *end = next;
+                return JSON_PARSE_OK;
+        default:
+                return JSON_PARSE_INVALID_BINARY;
+        }
+}
+
+json_type json_binary_get_type(const char *bin, size_t node) {
+        assert(bin != NULL);
+        return (json_type) (unsigned char) bin[node];
+}
+
+double json_binary_get_number(const char *bin, size_t node) {
+        double n;
+        assert(json_binary_get_type(bin, node) == JSON_NUMBER);
+        memcpy(&n, bin + node + 1, sizeof(double));
+        return n;
+}
+
+size_t json_binary_get_string_length(const char *bin, size_t node) {
+        assert(json_binary_get_type(bin, node) == JSON_STRING);
+        return json_binary_read_u32(bin + node + 1);
+}
+
+const char *json_binary_get_string(const char *bin, size_t node) {
+        assert(json_binary_get_type(bin, node) == JSON_STRING);
+        return bin + node + 5;
+}
+
+size_t json_binary_get_array_size(const char *bin, size_t node) {
+        assert(json_binary_get_type(bin, node) == JSON_ARRAY);
+        return json_binary_read_u32(bin + node + 1);
+}
+
+size_t json_binary_get_array_element(const char *bin, size_t node, size_t index) {
+        assert(index < json_binary_get_array_size(bin, node));
+        return json_binary_read_u32(bin + node + 5 + 4 * index);
+}
+
+static void json_binary_write_u32(char *p, size_t u) {
+        p[0] = (char) (0xFF & u);
+        p[1] = (char) (0xFF & u>>8);
+        p[2] = (char) (0xFF & u>>16);
+        p[3] = (char) (0xFF & u>>24);
+}
+
+static size_t json_binary_read_u32(const char *p) {
+        const unsigned char *b = (const unsigned char *) p;
+        return ((size_t) b[0] << 0)  |
+               ((size_t) b[1] << 8)  |
+               ((size_t) b[2] << 16) |
+               ((size_t) b[3] << 24);
+}
@@ -25,7 +25,11 @@ enum {
     JSON_PARSE_INVALID_STRING_CHAR,
     JSON_PARSE_INVALID_UNICODE_SURROGATE,
     JSON_PARSE_INVALID_UNICODE_HEX,
-    JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET
+    JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+    JSON_PARSE_INVALID_BINARY, // if the binary image is truncated or malformed
+    JSON_PARSE_MISS_KEY,
+    JSON_PARSE_MISS_COLON,
+    JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET
 };
 
 typedef struct json_value json_value;
@@ -49,10 +53,62 @@ int json_get_boolean(const json_value *v);
 void json_set_number(json_value *v, double n);
 double json_get_number(const json_value *v);
 void json_set_string(json_value *v, const char *s, size_t len);
-size_t json_get_string_length(json_value *v);
-const char* json_get_string(json_value *v);
-size_t json_get_array_size(json_value *v);
-json_value * json_get_array_element(json_value *v, size_t index);
+size_t json_get_string_length(const json_value *v);
+const char* json_get_string(const json_value *v);
+size_t json_get_array_size(const json_value *v);
+const json_value * json_get_array_element(const json_value *v, size_t index);
+
+/*
+ * Binary image: "CJB1" magic followed by the root node. Every node is a one
+ * byte json_type tag followed by its payload:
+ *   number: 8 byte double (host byte order)
+ *   string: u32 length, bytes, '\0'
+ *   array:  u32 size, size * u32 absolute offsets of the elements, elements
+ * All u32 fields are little endian. The offset table lets an image (e.g. a
+ * mmap'd cache file) be navigated in place with the json_binary_* accessors.
+ */
+#define JSON_BINARY_ROOT 4
+
+char *json_encode_binary(const json_value *v, size_t *length);
+int json_decode_binary(json_value *v, const char *bin, size_t length);
+int json_binary_check(const char *bin, size_t length);
+json_type json_binary_get_type(const char *bin, size_t node);
+double json_binary_get_number(const char *bin, size_t node);
+size_t json_binary_get_string_length(const char *bin, size_t node);
+const char *json_binary_get_string(const char *bin, size_t node);
+size_t json_binary_get_array_size(const char *bin, size_t node);
+size_t json_binary_get_array_element(const char *bin, size_t node, size_t index);
+
+/*
+ * Immutable, reference-counted document for sharing one parse result across
+ * threads. The root must not be modified once the document is created; the
+ * const accessors above are then safe to call concurrently without locks.
+ */
+typedef struct json_document json_document;
+
+int json_document_parse(json_document **d, const char *json);
+json_document *json_document_create(json_value *v);
+json_document *json_document_retain(json_document *d);
+void json_document_release(json_document *d);
+const json_value *json_document_root(const json_document *d);
+
+/*
+ * RCU-style publication point for the current document. Readers take a
+ * reference with json_slot_acquire and never wait; json_slot_publish swaps
+ * in a new document and waits for readers caught mid-acquire before dropping
+ * its reference to the old one, which is freed once the last reader releases.
+ */
+typedef struct {
+    json_document *current;
+    size_t epoch;
+    size_t readers[2];
+    int publishing;
+} json_slot;
+
+void json_slot_init(json_slot *s, json_document *d);
+json_document *json_slot_acquire(json_slot *s);
+void json_slot_publish(json_slot *s, json_document *d);
+void json_slot_free(json_slot *s);
 
 typedef struct {
     const char *json;
@@ -60,5 +116,15 @@ typedef struct {
     size_t size, top;
 } json_context;
 
+/*
+ * Building blocks for parsers emitted by cjson_gen. Each parses one token at
+ * c->json and advances past it. The string returned by json_parse_string_raw
+ * lives on the context stack and is only valid until the next push.
+ */
+void json_parse_whitespace(json_context *c);
+int json_parse_value(json_context *c, json_value *v);
+int json_parse_number(json_context *c, json_value *v);
+int json_parse_string_raw(json_context *c, const char **str, size_t *len);
+
 
 #endif
@@ -0,0 +1,69 @@
+#include "cjson.h"
+#include "cjson_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Compares the cjson_gen parser for order_msg with the generic path of
+ * json_parse followed by a copy into the struct. json_parse has no object
+ * support yet, so the generic path reads the same fields as a positional
+ * array.
+ */
+static const char *object_json =
+        "{ \"id\": 1024, \"symbol\": \"ACME\", \"price\": 101.25, "
+        "\"qty\": 300, \"active\": true, \"side\": \"buy\" }";
+static const char *array_json =
+        "[ 1024, \"ACME\", 101.25, 300, true, \"buy\" ]";
+
+static char *copy_string(const json_value *v, size_t *len) {
+        char *s;
+        *len = json_get_string_length(v);
+        s = (char *) malloc(*len + 1);
+        memcpy(s, json_get_string(v), *len + 1);
+        return s;
+}
+
+static int generic_parse(order_msg *out, const char *json) {
+        json_value v;
+        int ret;
+        json_val_init(&v);
+        if ((ret = json_parse(&v, json)) != JSON_PARSE_OK)
+                return ret;
+        out->id = json_get_number(json_get_array_element(&v, 0));
+        out->symbol = copy_string(json_get_array_element(&v, 1), &out->symbol_len);
+        out->price = json_get_number(json_get_array_element(&v, 2));
+        out->qty = json_get_number(json_get_array_element(&v, 3));
+        out->active = json_get_boolean(json_get_array_element(&v, 4));
+        out->side = copy_string(json_get_array_element(&v, 5), &out->side_len);
+        json_val_free(&v);
+        return JSON_PARSE_OK;
+}
+
+static double run(int (*parse)(order_msg *, const char *), const char *json, long n) {
+        order_msg m;
+        double sum = 0.0;
+        clock_t start = clock();
+        long i;
+        for (i = 0; i < n; i++) {
+                if (parse(&m, json) != JSON_PARSE_OK) {
+                        fprintf(stderr, "parse failed: %s\n", json);
+                        exit(1);
+                }
+                sum += m.price;
+                order_msg_free(&m);
+        }
+        if (sum != 101.25 * n)
+                fprintf(stderr, "unexpected checksum %g\n", sum);
+        return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / n;
+}
+
+int main(int argc, char *argv[]) {
+        long n = argc > 1 ? atol(argv[1]) : 1000000;
+        if (n <= 0)
+                n = 1;
+        printf("generic   %8.1f ns/msg\n", run(generic_parse, array_json, n));
+        printf("generated %8.1f ns/msg\n", run(order_msg_parse, object_json, n));
+        return 0;
+}
@@ -0,0 +1,305 @@
+/*
+ * cjson_gen: emits specialized parsers that read a fixed-shape JSON object
+ * straight into a C struct, skipping the generic json_value tree.
+ *
+ * usage: cjson_gen <schema> <out.h> <out.c>
+ *
+ * Schema syntax, one declaration per line ('#' starts a comment):
+ *
+ *     struct <name>
+ *             number <field>
+ *             boolean <field>
+ *             string <field>
+ *     end
+ *
+ * For each struct the generator writes `typedef struct {...} <name>;`,
+ * `int <name>_parse(<name> *out, const char *json)` and
+ * `void <name>_free(<name> *v)`. Keys are the field names; keys missing from
+ * the input leave the field zeroed and unknown keys are parsed and dropped.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GEN_MAX_STRUCTS 32
+#define GEN_MAX_FIELDS 64
+#define GEN_MAX_NAME 64
+
+typedef enum {
+    GEN_NUMBER,
+    GEN_BOOLEAN,
+    GEN_STRING
+} gen_type;
+
+typedef struct {
+    gen_type type;
+    char name[GEN_MAX_NAME];
+} gen_field;
+
+typedef struct {
+    char name[GEN_MAX_NAME];
+    gen_field fields[GEN_MAX_FIELDS];
+    size_t size;
+} gen_struct;
+
+static gen_struct structs[GEN_MAX_STRUCTS];
+static size_t struct_count = 0;
+
+static int gen_is_identifier(const char *s) {
+        if (!(isalpha((unsigned char) *s) || *s == '_'))
+                return 0;
+        for (s++; *s; s++)
+                if (!(isalnum((unsigned char) *s) || *s == '_'))
+                        return 0;
+        return 1;
+}
+
+static int gen_read_schema(const char *path) {
+        FILE *f;
+        char line[256], word[GEN_MAX_NAME], name[GEN_MAX_NAME], extra[2];
+        gen_struct *cur = NULL;
+        gen_field *field;
+        int lineno = 0, n;
+        char *hash;
+        if (!(f = fopen(path, "r"))) {
+                fprintf(stderr, "cjson_gen: cannot open %s\n", path);
+                return 0;
+        }
+        while (fgets(line, sizeof(line), f)) {
+                lineno++;
+                if ((hash = strchr(line, '#')))
+                        *hash = '\0';
+                n = sscanf(line, "%63s %63s %1s", word, name, extra);
+                if (n <= 0)
+                        continue;
+                if (n == 2 && strcmp(word, "struct") == 0 && !cur) {
+                        if (struct_count == GEN_MAX_STRUCTS)
+                                goto error;
+                        cur = &structs[struct_count++];
+                        strcpy(cur->name, name);
+                        cur->size = 0;
+                        if (!gen_is_identifier(name))
+                                goto error;
+                } else if (n == 1 && strcmp(word, "end") == 0 && cur) {
+                        cur = NULL;
+                } else if (n == 2 && cur && cur->size < GEN_MAX_FIELDS && gen_is_identifier(name)) {
+                        field = &cur->fields[cur->size++];
+                        strcpy(field->name, name);
+                        if (strcmp(word, "number") == 0)
+                                field->type = GEN_NUMBER;
+                        else if (strcmp(word, "boolean") == 0)
+                                field->type = GEN_BOOLEAN;
+                        else if (strcmp(word, "string") == 0)
+                                field->type = GEN_STRING;
+                        else
+                                goto error;
+                } else
+                        goto error;
+        }
+        fclose(f);
+        if (cur) {
+                fprintf(stderr, "%s: missing 'end' for struct %s\n", path, cur->name);
+                return 0;
+        }
+        return 1;
+error:
+        fprintf(stderr, "%s:%d: invalid schema line\n", path, lineno);
+        fclose(f);
+        return 0;
+}
+
+static const char *gen_basename(const char *path) {
+        const char *p = strrchr(path, '/');
+        return p ? p + 1 : path;
+}
+
+static void gen_header(FILE *f, const char *schema, const char *header) {
+        const char *p;
+        size_t i, j;
+        char guard[256];
+        for (i = 0, p = gen_basename(header); *p && i < sizeof(guard) - 3; p++)
+                guard[i++] = isalnum((unsigned char) *p) ? (char) toupper((unsigned char) *p) : '_';
+        guard[i++] = '_';
+        guard[i++] = '_';
+        guard[i] = '\0';
+
+        fprintf(f, "/* Generated by cjson_gen from %s. Do not edit. */\n", gen_basename(schema));
+        fprintf(f, "#ifndef %s\n#define %s\n\n#include \"cjson.h\"\n", guard, guard);
+        for (i = 0; i < struct_count; i++) {
+                const gen_struct *s = &structs[i];
+                fprintf(f, "\ntypedef struct {\n");
+                for (j = 0; j < s->size; j++) {
+                        const gen_field *field = &s->fields[j];
+                        switch (field->type) {
+                        case GEN_NUMBER:
+                                fprintf(f, "    double %s;\n", field->name);
+                                break;
+                        case GEN_BOOLEAN:
+                                fprintf(f, "    int %s;\n", field->name);
+                                break;
+                        case GEN_STRING:
+                                fprintf(f, "    char *%s;\n    size_t %s_len;\n", field->name, field->name);
+                                break;
+                        }
+                }
+                fprintf(f, "} %s;\n\n", s->name);
+                fprintf(f, "int %s_parse(%s *out, const char *json);\n", s->name, s->name);
+                fprintf(f, "void %s_free(%s *v);\n", s->name, s->name);
+        }
+        fprintf(f, "\n#endif\n");
+}
+
+/* Keys are matched by length first, so at most a handful of memcmp run per key. */
+static void gen_lookup(FILE *f, const gen_struct *s) {
+        size_t i, j, len;
+        int any;
+        fprintf(f, "\nstatic int %s_lookup(const char *key, size_t len) {\n", s->name);
+        fprintf(f, "        switch (len) {\n");
+        for (i = 0; i < s->size; i++) {
+                len = strlen(s->fields[i].name);
+                /* emit each length bucket once, at its first field */
+                for (j = 0, any = 0; j < i; j++)
+                        if (strlen(s->fields[j].name) == len)
+                                any = 1;
+                if (any)
+                        continue;
+                fprintf(f, "        case %lu:\n", (unsigned long) len);
+                for (j = i; j < s->size; j++)
+                        if (strlen(s->fields[j].name) == len)
+                                fprintf(f, "                if (memcmp(key, \"%s\", %lu) == 0) return %lu;\n",
+                                        s->fields[j].name, (unsigned long) len, (unsigned long) j);
+                fprintf(f, "                break;\n");
+        }
+        fprintf(f, "        }\n        return -1;\n}\n");
+}
+
+static void gen_field_parser(FILE *f, const gen_struct *s) {
+        size_t i;
+        fprintf(f, "\nstatic int %s_parse_field(json_context *c, %s *out, int field) {\n", s->name, s->name);
+        fprintf(f, "        json_value tmp;\n        const char *str;\n        size_t len;\n        int ret;\n");
+        fprintf(f, "        (void) str;\n        (void) len;\n");
+        fprintf(f, "        switch (field) {\n");
+        for (i = 0; i < s->size; i++) {
+                const char *name = s->fields[i].name;
+                fprintf(f, "        case %lu:\n", (unsigned long) i);
+                switch (s->fields[i].type) {
+                case GEN_NUMBER:
+                        fprintf(f, "                if ((ret = json_parse_number(c, &tmp)) != JSON_PARSE_OK)\n");
+                        fprintf(f, "                        return ret;\n");
+                        fprintf(f, "                out->%s = tmp.val.number;\n", name);
+                        break;
+                case GEN_BOOLEAN:
+                        fprintf(f, "                if ((ret = json_parse_value(c, &tmp)) != JSON_PARSE_OK)\n");
+                        fprintf(f, "                        return ret;\n");
+                        fprintf(f, "                if (tmp.type != JSON_TRUE && tmp.type != JSON_FALSE) {\n");
+                        fprintf(f, "                        json_val_free(&tmp);\n");
+                        fprintf(f, "                        return JSON_PARSE_INVALID_VALUE;\n");
+                        fprintf(f, "                }\n");
+                        fprintf(f, "                out->%s = tmp.type == JSON_TRUE;\n", name);
+                        break;
+                case GEN_STRING:
+                        fprintf(f, "                if (*c->json != '\\\"')\n");
+                        fprintf(f, "                        return JSON_PARSE_INVALID_VALUE;\n");
+                        fprintf(f, "                if ((ret = json_parse_string_raw(c, &str, &len)) != JSON_PARSE_OK)\n");
+                        fprintf(f, "                        return ret;\n");
+                        fprintf(f, "                free(out->%s);\n", name);
+                        fprintf(f, "                out->%s = (char *) malloc(len + 1);\n", name);
+                        fprintf(f, "                memcpy(out->%s, str, len);\n", name);
+                        fprintf(f, "                out->%s[len] = '\\0';\n", name);
+                        fprintf(f, "                out->%s_len = len;\n", name);
+                        break;
+                }
+                fprintf(f, "                return JSON_PARSE_OK;\n");
+        }
+        fprintf(f, "        default:\n");
+        fprintf(f, "                json_val_init(&tmp);\n");
+        fprintf(f, "                if ((ret = json_parse_value(c, &tmp)) == JSON_PARSE_OK)\n");
+        fprintf(f, "                        json_val_free(&tmp);\n");
+        fprintf(f, "                return ret;\n");
+        fprintf(f, "        }\n}\n");
+}
+
+static void gen_object_parser(FILE *f, const gen_struct *s) {
+        const char *n = s->name;
+        fprintf(f, "\nstatic int %s_parse_object(json_context *c, %s *out) {\n", n, n);
+        fprintf(f, "        const char *key;\n        size_t len;\n        int field, ret;\n");
+        fprintf(f, "        json_parse_whitespace(c);\n");
+        fprintf(f, "        if (*c->json != '{')\n                return JSON_PARSE_INVALID_VALUE;\n");
+        fprintf(f, "        c->json++;\n        json_parse_whitespace(c);\n");
+        fprintf(f, "        if (*c->json == '}') {\n                c->json++;\n                return JSON_PARSE_OK;\n        }\n");
+        fprintf(f, "        while (1) {\n");
+        fprintf(f, "                if (*c->json != '\\\"')\n                        return JSON_PARSE_MISS_KEY;\n");
+        fprintf(f, "                if ((ret = json_parse_string_raw(c, &key, &len)) != JSON_PARSE_OK)\n");
+        fprintf(f, "                        return ret;\n");
+        fprintf(f, "                field = %s_lookup(key, len);\n", n);
+        fprintf(f, "                json_parse_whitespace(c);\n");
+        fprintf(f, "                if (*c->json != ':')\n                        return JSON_PARSE_MISS_COLON;\n");
+        fprintf(f, "                c->json++;\n                json_parse_whitespace(c);\n");
+        fprintf(f, "                if ((ret = %s_parse_field(c, out, field)) != JSON_PARSE_OK)\n", n);
+        fprintf(f, "                        return ret;\n");
+        fprintf(f, "                json_parse_whitespace(c);\n");
+        fprintf(f, "                if (*c->json == ',') {\n");
+        fprintf(f, "                        c->json++;\n                        json_parse_whitespace(c);\n");
+        fprintf(f, "                } else if (*c->json == '}') {\n");
+        fprintf(f, "                        c->json++;\n                        return JSON_PARSE_OK;\n");
+        fprintf(f, "                } else\n                        return JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET;\n");
+        fprintf(f, "        }\n}\n");
+
+        fprintf(f, "\nint %s_parse(%s *out, const char *json) {\n", n, n);
+        fprintf(f, "        json_context c;\n        int ret;\n");
+        fprintf(f, "        assert(out != NULL && json != NULL);\n");
+        fprintf(f, "        memset(out, 0, sizeof(*out));\n");
+        fprintf(f, "        c.json = json;\n        c.stack = NULL;\n        c.size = c.top = 0;\n");
+        fprintf(f, "        ret = %s_parse_object(&c, out);\n", n);
+        fprintf(f, "        if (ret == JSON_PARSE_OK) {\n");
+        fprintf(f, "                json_parse_whitespace(&c);\n");
+        fprintf(f, "                if (*c.json != '\\0')\n");
+        fprintf(f, "                        ret = JSON_PARSE_ROOT_NOT_SINGULAR;\n        }\n");
+        fprintf(f, "        free(c.stack);\n");
+        fprintf(f, "        if (ret != JSON_PARSE_OK)\n                %s_free(out);\n", n);
+        fprintf(f, "        return ret;\n}\n");
+}
+
+static void gen_free(FILE *f, const gen_struct *s) {
+        size_t i;
+        fprintf(f, "\nvoid %s_free(%s *v) {\n", s->name, s->name);
+        fprintf(f, "        assert(v != NULL);\n");
+        for (i = 0; i < s->size; i++)
+                if (s->fields[i].type == GEN_STRING)
+                        fprintf(f, "        free(v->%s);\n        v->%s = NULL;\n        v->%s_len = 0;\n",
+                                s->fields[i].name, s->fields[i].name, s->fields[i].name);
+        fprintf(f, "}\n");
+}
+
+static void gen_source(FILE *f, const char *schema, const char *header) {
+        size_t i;
+        fprintf(f, "/* Generated by cjson_gen from %s. Do not edit. */\n", gen_basename(schema));
+        fprintf(f, "#include <assert.h>\n#include <stdlib.h>\n#include <string.h>\n");
+        fprintf(f, "#include \"%s\"\n", gen_basename(header));
+        for (i = 0; i < struct_count; i++) {
+                gen_lookup(f, &structs[i]);
+                gen_field_parser(f, &structs[i]);
+                gen_object_parser(f, &structs[i]);
+                gen_free(f, &structs[i]);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        FILE *h, *c;
+        if (argc != 4) {
+                fprintf(stderr, "usage: %s <schema> <out.h> <out.c>\n", argv[0]);
+                return 2;
+        }
+        if (!gen_read_schema(argv[1]))
+                return 1;
+        if (!(h = fopen(argv[2], "w")) || !(c = fopen(argv[3], "w"))) {
+                fprintf(stderr, "cjson_gen: cannot write output\n");
+                return 1;
+        }
+        gen_header(h, argv[1], argv[2]);
+        gen_source(c, argv[1], argv[2]);
+        fclose(h);
+        fclose(c);
+        return 0;
+}
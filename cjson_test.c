@@ -1,5 +1,7 @@
 #include "cjson.h"
+#include "cjson_msg.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static int main_ret_val = 0;
@@ -263,6 +265,182 @@ static void test_parse_array() {
         EXPECT_EQ_DOUBLE(1.0, json_get_number(json_get_array_element(json_get_array_element(&v, 3), 1)));
         EXPECT_EQ_DOUBLE(2.0, json_get_number(json_get_array_element(json_get_array_element(&v, 3), 2)));
         json_val_free(&v);
+
+        json_val_init(&v);
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_parse(&v, "[0,-0]"));
+        EXPECT_EQ_SIZE_T(2, json_get_array_size(&v));
+        json_val_free(&v);
+}
+
+static void test_binary_roundtrip() {
+        json_value v, w;
+        char *bin;
+        size_t len;
+        json_val_init(&v);
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_parse(&v, "[ null, false, true, 1.5, \"a\\u0000b\", [ [ ], [ 1, \"\" ] ] ]"));
+        bin = json_encode_binary(&v, &len);
+        EXPECT_TRUE(bin != NULL);
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_binary_check(bin, len));
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_decode_binary(&w, bin, len));
+        EXPECT_EQ_INT(JSON_ARRAY, json_get_type(&w));
+        EXPECT_EQ_SIZE_T(6, json_get_array_size(&w));
+        EXPECT_NULL(json_get_type(json_get_array_element(&w, 0)));
+        EXPECT_FALSE(json_get_boolean(json_get_array_element(&w, 1)));
+        EXPECT_TRUE(json_get_boolean(json_get_array_element(&w, 2)));
+        EXPECT_EQ_DOUBLE(1.5, json_get_number(json_get_array_element(&w, 3)));
+        EXPECT_EQ_STRING("a\0b", json_get_string(json_get_array_element(&w, 4)),
+                         json_get_string_length(json_get_array_element(&w, 4)));
+        EXPECT_EQ_SIZE_T(0, json_get_array_size(json_get_array_element(json_get_array_element(&w, 5), 0)));
+        EXPECT_EQ_SIZE_T(2, json_get_array_size(json_get_array_element(json_get_array_element(&w, 5), 1)));
+        json_val_free(&w);
+        json_val_free(&v);
+        free(bin);
+}
+
+static void test_binary_in_place() {
+        json_value v;
+        char *bin;
+        size_t len, node;
+        json_val_init(&v);
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_parse(&v, "[ 123, [ \"abc\" ] ]"));
+        bin = json_encode_binary(&v, &len);
+        EXPECT_EQ_INT(JSON_ARRAY, json_binary_get_type(bin, JSON_BINARY_ROOT));
+        EXPECT_EQ_SIZE_T(2, json_binary_get_array_size(bin, JSON_BINARY_ROOT));
+        node = json_binary_get_array_element(bin, JSON_BINARY_ROOT, 0);
+        EXPECT_EQ_DOUBLE(123.0, json_binary_get_number(bin, node));
+        node = json_binary_get_array_element(bin, JSON_BINARY_ROOT, 1);
+        node = json_binary_get_array_element(bin, node, 0);
+        EXPECT_EQ_INT(JSON_STRING, json_binary_get_type(bin, node));
+        EXPECT_EQ_STRING("abc", json_binary_get_string(bin, node), json_binary_get_string_length(bin, node));
+        json_val_free(&v);
+        free(bin);
+}
+
+#define TEST_BINARY_ERROR(error, bin, len)                                      \
+        do{                                                                     \
+                json_value v;                                                   \
+                EXPECT_EQ_INT(error, json_binary_check(bin, len));              \
+                EXPECT_EQ_INT(error, json_decode_binary(&v, bin, len));         \
+                EXPECT_EQ_INT(JSON_NULL, json_get_type(&v));                    \
+        }while(0)
+
+static void test_binary_invalid() {
+        json_value v;
+        char *bin;
+        size_t len;
+        TEST_BINARY_ERROR(JSON_PARSE_INVALID_BINARY, "", 0);
+        TEST_BINARY_ERROR(JSON_PARSE_INVALID_BINARY, "CJB0\0", 5);
+        TEST_BINARY_ERROR(JSON_PARSE_INVALID_BINARY, "CJB1", 4);
+        TEST_BINARY_ERROR(JSON_PARSE_INVALID_BINARY, "CJB1\7", 5);
+        TEST_BINARY_ERROR(JSON_PARSE_ROOT_NOT_SINGULAR, "CJB1\0\0", 6);
+
+        json_val_init(&v);
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_parse(&v, "[ \"abc\", [ 1, 2 ] ]"));
+        bin = json_encode_binary(&v, &len);
+        for (len--; len > 0; len--)
+                TEST_BINARY_ERROR(JSON_PARSE_INVALID_BINARY, bin, len);
+        json_val_free(&v);
+        free(bin);
+}
+
+static void test_binary() {
+        test_binary_roundtrip();
+        test_binary_in_place();
+        test_binary_invalid();
+}
+
+static void test_generated_parse() {
+        order_msg m;
+        EXPECT_EQ_INT(JSON_PARSE_OK, order_msg_parse(&m,
+                "{ \"id\": 7, \"symbol\" : \"AB\\u0043\", \"price\":0,\"qty\": 1e2, "
+                "\"active\": true, \"side\": \"sell\" }"));
+        EXPECT_EQ_DOUBLE(7.0, m.id);
+        EXPECT_EQ_STRING("ABC", m.symbol, m.symbol_len);
+        EXPECT_EQ_DOUBLE(0.0, m.price);
+        EXPECT_EQ_DOUBLE(100.0, m.qty);
+        EXPECT_TRUE(m.active);
+        EXPECT_EQ_STRING("sell", m.side, m.side_len);
+        order_msg_free(&m);
+
+        /* missing keys stay zeroed, unknown keys are skipped */
+        EXPECT_EQ_INT(JSON_PARSE_OK, order_msg_parse(&m, "{ \"sid\": [1, \"x\"], \"qty\": 5 }"));
+        EXPECT_EQ_DOUBLE(5.0, m.qty);
+        EXPECT_FALSE(m.active);
+        EXPECT_TRUE(m.symbol == NULL);
+        order_msg_free(&m);
+
+        EXPECT_EQ_INT(JSON_PARSE_OK, order_msg_parse(&m, " { } "));
+        order_msg_free(&m);
+}
+
+#define TEST_GENERATED_ERROR(error, json)                               \
+        do{                                                             \
+                order_msg m;                                            \
+                EXPECT_EQ_INT(error, order_msg_parse(&m, json));        \
+                EXPECT_TRUE(m.symbol == NULL && m.side == NULL);        \
+        }while(0)
+
+static void test_generated_parse_error() {
+        TEST_GENERATED_ERROR(JSON_PARSE_INVALID_VALUE, "[]");
+        TEST_GENERATED_ERROR(JSON_PARSE_INVALID_VALUE, "{\"id\": \"1\"}");
+        TEST_GENERATED_ERROR(JSON_PARSE_INVALID_VALUE, "{\"symbol\": 1}");
+        TEST_GENERATED_ERROR(JSON_PARSE_INVALID_VALUE, "{\"active\": null}");
+        TEST_GENERATED_ERROR(JSON_PARSE_MISS_KEY, "{1: 1}");
+        TEST_GENERATED_ERROR(JSON_PARSE_MISS_KEY, "{\"side\": \"buy\", }");
+        TEST_GENERATED_ERROR(JSON_PARSE_MISS_COLON, "{\"id\" 1}");
+        TEST_GENERATED_ERROR(JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"side\": \"buy\"");
+        TEST_GENERATED_ERROR(JSON_PARSE_MISS_QUOTATION_MARK, "{\"symbol\": \"AB");
+        TEST_GENERATED_ERROR(JSON_PARSE_ROOT_NOT_SINGULAR, "{} x");
+}
+
+static void test_generated() {
+        test_generated_parse();
+        test_generated_parse_error();
+}
+
+static void test_document() {
+        json_document *d;
+        json_value v;
+        EXPECT_EQ_INT(JSON_PARSE_OK, json_document_parse(&d, "[ 1, \"abc\" ]"));
+        EXPECT_EQ_INT(JSON_ARRAY, json_get_type(json_document_root(d)));
+        EXPECT_EQ_SIZE_T(2, json_get_array_size(json_document_root(d)));
+        EXPECT_TRUE(json_document_retain(d) == d);
+        json_document_release(d);
+        EXPECT_EQ_STRING("abc", json_get_string(json_get_array_element(json_document_root(d), 1)), 3);
+        json_document_release(d);
+
+        EXPECT_EQ_INT(JSON_PARSE_INVALID_VALUE, json_document_parse(&d, "[ nul ]"));
+        EXPECT_TRUE(d == NULL);
+
+        json_val_init(&v);
+        json_set_string(&v, "moved", 5);
+        d = json_document_create(&v);
+        EXPECT_NULL(json_get_type(&v));
+        EXPECT_EQ_STRING("moved", json_get_string(json_document_root(d)), 5);
+        json_document_release(d);
+}
+
+static void test_slot() {
+        json_slot s;
+        json_document *d1, *d2, *r1, *r2;
+        json_slot_init(&s, NULL);
+        EXPECT_TRUE(json_slot_acquire(&s) == NULL);
+
+        json_document_parse(&d1, "1");
+        json_slot_publish(&s, d1);
+        r1 = json_slot_acquire(&s);
+        EXPECT_TRUE(r1 == d1);
+
+        /* the old version stays readable until its last reader releases it */
+        json_document_parse(&d2, "2");
+        json_slot_publish(&s, d2);
+        r2 = json_slot_acquire(&s);
+        EXPECT_TRUE(r2 == d2);
+        EXPECT_EQ_DOUBLE(1.0, json_get_number(json_document_root(r1)));
+        EXPECT_EQ_DOUBLE(2.0, json_get_number(json_document_root(r2)));
+        json_document_release(r1);
+        json_document_release(r2);
+        json_slot_free(&s);
 }
 
 static void test_access(){
@@ -292,6 +470,10 @@ static void test_parse() {
 int main() {
         test_parse();
         test_access();
+        test_binary();
+        test_generated();
+        test_document();
+        test_slot();
         printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count,
                test_pass * 100.0 / test_count);
         return main_ret_val;